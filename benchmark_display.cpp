@@ -0,0 +1,190 @@
+#include "display.hpp"
+#include "workloads.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+// Every heap allocation made by the program goes through here, so the
+// difference of the counter around a stage is its allocation count.
+static std::uint64_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+// Kept out of line: once inlined, GCC pairs the free() with the call to
+// operator new and reports a mismatched deallocation.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { ::operator delete(p); }
+
+namespace {
+
+// Golden frames in golden/ were made by the original display() for these
+// workloads; they do not depend on --samples.
+const std::uint64_t golden_samples = 100000;
+const unsigned int max_golden_bins = 100;
+
+struct options {
+  std::uint64_t samples = 1000000;
+  unsigned int max_bins = 1000000;
+  std::string json_file;             // empty: print JSON to stdout
+  std::string golden_dir = "golden"; // relative to the working directory
+  bool update_golden = false;        // write missing golden files
+};
+
+struct stage {
+  std::string name;
+  double seconds = 0;        // fastest repetition
+  std::uint64_t allocations = 0;
+};
+
+struct result {
+  std::string workload;
+  unsigned int bins = 0;
+  std::uint64_t samples = 0;
+  std::size_t output_bytes = 0;
+  std::vector<stage> stages;
+  bool matches_reference = false;
+  std::string golden; // "match", "mismatch", "missing", "written" or "none"
+};
+
+// Runs `f` `repetitions` times and records the fastest run and the
+// allocations of the last one.
+template <class function>
+stage measure(const std::string& name, const unsigned int repetitions, function f) {
+  stage s{name};
+  for (unsigned int i = 0; i < repetitions; ++i) {
+    const std::uint64_t before = allocations;
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    s.allocations = allocations - before;
+    if (i == 0 || elapsed.count() < s.seconds) s.seconds = elapsed.count();
+  }
+  return s;
+}
+
+// Compares both the reference pipeline and the streaming renderer with
+// the golden frame of a small workload.
+std::string check_golden(const workloads::distribution d, const unsigned int bins,
+                         const options& opt) {
+  if (bins > max_golden_bins) return "none";
+  auto h = workloads::make_histogram(d, bins);
+  workloads::fill(h, d, golden_samples);
+  auto h_data = display::extract_data(h);
+  const std::string reference = display::draw_histogram(h_data, display::precalculate_visual_data(h_data));
+  display::renderer renderer;
+
+  const std::string path = opt.golden_dir + "/" + workloads::name(d) + "_" + std::to_string(bins) + ".txt";
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    if (!opt.update_golden) return "missing";
+    std::ofstream(path, std::ios::binary) << reference;
+    return "written";
+  }
+  const std::string golden((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  return golden == reference && golden == renderer.render(h) ? "match" : "mismatch";
+}
+
+result run(const workloads::distribution d, const unsigned int bins, const options& opt) {
+  auto h = workloads::make_histogram(d, bins);
+  workloads::fill(h, d, opt.samples);
+
+  result r{workloads::name(d), bins, opt.samples, 0, {}, false, "none"};
+  const unsigned int repetitions = std::max(1u, std::min(20u, 200000u / bins));
+
+  display::extract h_data;
+  r.stages.push_back(measure("extract_data", repetitions, [&] { h_data = display::extract_data(h); }));
+
+  std::vector<int> scale_factors;
+  r.stages.push_back(measure("calculate_scale_factors", repetitions, [&] {
+    scale_factors = display::calculate_scale_factors(h_data.values_);
+  }));
+
+  std::optional<display::visualization_data> v_data;
+  r.stages.push_back(measure("precalculate_visual_data", repetitions, [&] {
+    v_data.emplace(display::precalculate_visual_data(h_data));
+  }));
+
+  std::string reference;
+  r.stages.push_back(measure("draw_histogram", repetitions, [&] {
+    reference = display::draw_histogram(h_data, *v_data);
+  }));
+
+  display::renderer renderer;
+  renderer.render(h); // warm-up, sizes the reusable buffers
+  r.stages.push_back(measure("renderer", repetitions, [&] { renderer.render(h); }));
+
+  r.output_bytes = reference.size();
+  r.matches_reference = renderer.buffer() == reference;
+  r.golden = check_golden(d, bins, opt);
+  return r;
+}
+
+void write_json(std::ostream& os, const std::vector<result>& results) {
+  os << "{\n  \"results\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const auto& r = results[i];
+    os << (i ? "," : "") << "\n    {\"workload\": \"" << r.workload << "\", \"bins\": " << r.bins
+       << ", \"samples\": " << r.samples << ", \"output_bytes\": " << r.output_bytes
+       << ", \"matches_reference\": " << (r.matches_reference ? "true" : "false")
+       << ", \"golden\": \"" << r.golden << "\", \"stages\": [";
+    for (std::size_t j = 0; j < r.stages.size(); ++j) {
+      const auto& s = r.stages[j];
+      os << (j ? ", " : "") << "{\"name\": \"" << s.name << "\", \"seconds\": " << s.seconds
+         << ", \"allocations\": " << s.allocations
+         << ", \"bytes_per_second\": " << (s.seconds > 0 ? r.output_bytes / s.seconds : 0) << "}";
+    }
+    os << "]}";
+  }
+  os << "\n  ]\n}\n";
+}
+
+options parse_options(const int argc, char** argv) {
+  options opt;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--update-golden") {
+      opt.update_golden = true;
+      continue;
+    }
+    if (i + 1 == argc) break;
+    if (arg == "--samples") opt.samples = std::strtoull(argv[i + 1], nullptr, 10);
+    else if (arg == "--max-bins") opt.max_bins = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (arg == "--json") opt.json_file = argv[i + 1];
+    else if (arg == "--golden") opt.golden_dir = argv[i + 1];
+    ++i;
+  }
+  return opt;
+}
+
+} // namespace
+
+// Usage: benchmark_display [--samples N] [--max-bins N] [--json FILE]
+//                          [--golden DIR] [--update-golden]
+int main(int argc, char** argv) {
+  const options opt = parse_options(argc, argv);
+
+  std::vector<result> results;
+  for (auto d : {workloads::distribution::uniform, workloads::distribution::normal,
+                 workloads::distribution::latency})
+    for (unsigned int bins : {5u, 100u, 10000u, 1000000u})
+      if (bins <= opt.max_bins) results.push_back(run(d, bins, opt));
+
+  bool ok = true;
+  for (const auto& r : results)
+    ok = ok && r.matches_reference && (r.golden == "match" || r.golden == "none" || r.golden == "written");
+
+  if (opt.json_file.empty()) {
+    write_json(std::cout, results);
+  } else {
+    std::ofstream out(opt.json_file);
+    write_json(out, results);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -5,23 +5,34 @@
 #include <boost/histogram.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace display {
-namespace {
-using namespace boost::histogram;
-
-const unsigned int histogram_width = 60; // 60 characters
-const float max_bin_coefficient = 0.95;  // 95% of histogram_width
 
 struct extract {
     std::vector<std::string> upper_bounds_;
     std::vector<std::string> lower_bounds_;
-    std::vector<int> values_;
+    std::vector<double> values_;          // bar lengths are scaled from these
+    std::vector<std::string> str_values_; // formatted for the value type
     unsigned int size() const {return values_.size();}
 };
 
@@ -49,6 +60,151 @@ struct visualization_data {
                      {}
 };
 
+enum class bar_scale { linear, log };
+
+// Cumulative counts of the bins in indexed(h, coverage::all) order, so
+// that quantiles are found by binary search instead of a storage scan.
+// The index stays valid until the histogram is filled again; matches()
+// checks a fresh extract against it.
+class quantile_index {
+public:
+  quantile_index() = default;
+
+  template <class histogram>
+  explicit quantile_index(const histogram& h) { build(h); }
+
+  template <class histogram>
+  void build(const histogram& h);
+
+  void clear() {
+    lower_bounds_.clear();
+    upper_bounds_.clear();
+    cumulative_.clear();
+  }
+
+  void add(const double lower, const double upper, const double count) {
+    lower_bounds_.push_back(lower);
+    upper_bounds_.push_back(upper);
+    cumulative_.push_back(count);
+  }
+
+  // Turns the collected counts into running sums in one pass.
+  void finish() { std::partial_sum(cumulative_.begin(), cumulative_.end(), cumulative_.begin()); }
+
+  bool empty() const { return cumulative_.empty(); }
+  double total() const { return empty() ? 0 : cumulative_.back(); }
+
+  // True if `data` has as many bins and the same total as the index, in
+  // which case no fill happened since the build. A reset followed by
+  // refilling to the same total is not detected.
+  bool matches(const extract& data) const {
+    return data.values_.size() == cumulative_.size() &&
+           std::accumulate(data.values_.begin(), data.values_.end(), 0.0) == total();
+  }
+
+  // Index of the bin that holds quantile q, for q in [0, 1].
+  size_t row(const double q) const {
+    const double target = q * total();
+    const auto it = target > 0
+        ? std::lower_bound(cumulative_.begin(), cumulative_.end(), target)
+        : std::upper_bound(cumulative_.begin(), cumulative_.end(), 0.0);
+    return std::min<size_t>(it - cumulative_.begin(), cumulative_.size() - 1);
+  }
+
+  // Quantile q, interpolated linearly inside its bin.
+  double value(const double q) const {
+    const size_t i = row(q);
+    const double lower = lower_bounds_[i], upper = upper_bounds_[i];
+    if (!std::isfinite(lower)) return upper;
+    if (!std::isfinite(upper)) return lower;
+
+    const double before = i ? cumulative_[i - 1] : 0;
+    const double count = cumulative_[i] - before;
+    const double fraction = count > 0 ? (q * total() - before) / count : 0;
+    return lower + std::clamp(fraction, 0.0, 1.0) * (upper - lower);
+  }
+
+private:
+  std::vector<double> lower_bounds_;
+  std::vector<double> upper_bounds_;
+  std::vector<double> cumulative_;
+};
+
+namespace {
+using namespace boost::histogram;
+
+const unsigned int histogram_width = 60; // 60 characters
+const float max_bin_coefficient = 0.95;  // 95% of histogram_width
+const unsigned int max_number_width = 320; // longest "%.1f" of a double
+const size_t cache_line_size = 64;         // keeps shards on separate lines
+const size_t export_chunk_size = 1 << 16;  // bytes buffered per write
+const char binary_magic[8] = {'H', 'I', 'S', 'T', 'B', 'I', 'N', '\0'};
+const std::uint32_t binary_version = 1;
+const std::uint32_t binary_byte_order = 0x01020304;
+
+template <class T>
+struct is_weighted_sum : std::false_type {};
+template <class T>
+struct is_weighted_sum<accumulators::weighted_sum<T>> : std::true_type {};
+
+template <class T>
+struct is_mean : std::false_type {};
+template <class T>
+struct is_mean<accumulators::mean<T>> : std::true_type {};
+template <class T>
+struct is_mean<accumulators::weighted_mean<T>> : std::true_type {};
+
+size_t format_bound(char* first, const double bound) {
+  return std::to_chars(first, first + max_number_width, bound,
+                       std::chars_format::fixed, 1).ptr - first;
+}
+
+// Whole numbers are printed with all digits, fractions with six
+// significant digits.
+size_t format_number(char* first, const double number) {
+  char* const last = first + max_number_width;
+  if (std::abs(number) < 0x1.0p53 && number == std::trunc(number))
+    return std::to_chars(first, last, number, std::chars_format::fixed).ptr - first;
+  return std::to_chars(first, last, number, std::chars_format::general, 6).ptr - first;
+}
+
+// Weighted sum as "value +- standard deviation".
+size_t format_weighted(char* first, const double value, const double variance) {
+  char* p = first + format_number(first, value);
+  p = std::copy_n(" +- ", 4, p);
+  return p - first + format_number(p, std::sqrt(variance));
+}
+
+// Bin content as shown in the value column, chosen by the storage's
+// value type at compile time.
+template <class T>
+size_t format_value(char* first, const T& value) {
+  if constexpr (is_weighted_sum<T>::value) {
+    return format_weighted(first, value.value(), value.variance());
+  } else if constexpr (is_mean<T>::value) {
+    return format_number(first, value.value());
+  } else if constexpr (std::is_integral<T>::value) {
+    return std::to_chars(first, first + max_number_width, value).ptr - first;
+  } else {
+    return format_number(first, static_cast<double>(value));
+  }
+}
+
+// Bin content that determines the bar length.
+template <class T>
+double bar_value(const T& value) {
+  if constexpr (is_weighted_sum<T>::value || is_mean<T>::value)
+    return value.value();
+  else
+    return static_cast<double>(value);
+}
+
+template <class T>
+std::string value_to_string(const T& value) {
+  char number[max_number_width];
+  return std::string(number, format_value(number, value));
+}
+
 template <class histogram>
 extract extract_data(const histogram& h) {
   std::string lower, upper;
@@ -59,13 +215,32 @@ extract extract_data(const histogram& h) {
   for (auto x : data) {
     lower = str( boost::format("%.1f") % x.bin().lower() );
     upper = str( boost::format("%.1f") % x.bin().upper() );
+    const typename histogram::value_type value = *x;
     ex.lower_bounds_.push_back(lower);
     ex.upper_bounds_.push_back(upper);
-    ex.values_.push_back(*x);
+    ex.values_.push_back(bar_value(value));
+    ex.str_values_.push_back(value_to_string(value));
   }
   return ex;    
 }
 
+// Same as extract_data(h), and rebuilds `index` during the same traversal.
+template <class histogram>
+extract extract_data(const histogram& h, quantile_index& index) {
+  extract ex;
+  index.clear();
+  for (auto&& x : indexed(h, coverage::all)) {
+    ex.lower_bounds_.push_back(str( boost::format("%.1f") % x.bin().lower() ));
+    ex.upper_bounds_.push_back(str( boost::format("%.1f") % x.bin().upper() ));
+    const typename histogram::value_type value = *x;
+    ex.values_.push_back(bar_value(value));
+    ex.str_values_.push_back(value_to_string(value));
+    index.add(x.bin().lower(), x.bin().upper(), ex.values_.back());
+  }
+  index.finish();
+  return ex;
+}
+
 std::string get_single_label(const extract& data,
                              const unsigned int index, 
                              const unsigned int column_width1,
@@ -96,14 +271,22 @@ std::string get_single_str_value(const std::vector<std::string>& str_values,
   return str_value;
 }
 
-std::vector<int> calculate_scale_factors(const std::vector<int>& values) {
+std::vector<int> calculate_scale_factors(const std::vector<double>& values,
+                                         const bar_scale scale = bar_scale::linear) {
   std::vector<int> scale_factors{};
   const unsigned int longest_bin = max_bin_coefficient * histogram_width;
 
   auto max_value = std::max_element(values.begin(), values.end());
 
+  if (scale == bar_scale::log) {
+    const double log_max = std::log1p(*max_value);
+    for (const auto& x : values)
+      scale_factors.push_back(log_max > 0 ? longest_bin * std::log1p(std::max(0.0, x)) / log_max : 0);
+    return scale_factors;
+  }
+
   for (const auto& x : values) {
-    int result = x * longest_bin / (*max_value);
+    int result = *max_value > 0 ? std::max(0.0, x * longest_bin / (*max_value)) : 0;
     scale_factors.push_back(result);
   }
   return scale_factors;
@@ -118,15 +301,6 @@ size_t get_max_width(const std::vector<std::string>& container) {
   return max_length;
 }
 
-std::vector<std::string> convert_to_str_vec(const std::vector<int>& values) {
-  std::vector<std::string> string_values;
-  string_values.reserve(values.size());
-
-  std::transform(values.begin(), values.end(), std::back_inserter(string_values),
-                 [](int i) { return std::to_string(i); });
-  return string_values;
-}
-
 std::string draw_line(const unsigned int num, const char c = '*', bool complete = true) {
   std::stringstream line;
   unsigned int i = 0;
@@ -153,25 +327,30 @@ std::string get_external_line(const unsigned int labels_width) {
   return external_line.str();
 }
 
-std::string get_top_line(const unsigned int labels_width,
-                         const std::vector<int>& values) {
+inline std::string get_top_line(const unsigned int labels_width,
+                                const std::vector<double>& values,
+                                const bar_scale scale = bar_scale::linear) {
   std::stringstream top_line;
 
   const unsigned int min = 0;
   auto max_value = std::max_element(values.begin(), values.end());
-  const float max = *max_value / max_bin_coefficient;
+  float max = *max_value / max_bin_coefficient;
+  if (scale == bar_scale::log) // value at the full bar width
+    max = std::expm1(std::log1p(*max_value) / max_bin_coefficient);
 
   std::string min_max = str(boost::format("%-i %.1f") % min %
                             boost::io::group(std::setw(histogram_width), max));
 
   top_line << draw_line(labels_width, ' ', false) << " " << min_max;
+  if (scale == bar_scale::log) top_line << " (log)";
   return top_line.str();
 }
 
-visualization_data precalculate_visual_data(extract& h_data){
+visualization_data precalculate_visual_data(const extract& h_data,
+                                            const bar_scale scale = bar_scale::linear){
   const unsigned int additional_offset = 6; // 6 white characters  
-  const auto scale_factors = calculate_scale_factors(h_data.values_);
-  const auto str_values = convert_to_str_vec(h_data.values_);
+  const auto scale_factors = calculate_scale_factors(h_data.values_, scale);
+  const auto& str_values = h_data.str_values_;
   const auto lower_width = get_max_width(h_data.lower_bounds_); 
   const auto upper_width = get_max_width(h_data.upper_bounds_);
   const auto str_values_width = get_max_width(str_values);
@@ -182,21 +361,374 @@ visualization_data precalculate_visual_data(extract& h_data){
   return v_data;
 }
 
-std::string draw_histogram(const extract& h_data, const visualization_data& v_data) {
+std::string get_histogram_row(const extract& h_data,
+                              const visualization_data& v_data,
+                              const unsigned int index) {
+  return get_single_label(h_data, index, v_data.lower_bounds_width_, v_data.upper_bounds_width_) + "  "
+       + get_single_str_value(v_data.str_values_, index, v_data.str_values_width_) + " "
+       + get_single_histogram_line(v_data.scale_factors_, index);
+}
+
+// `row_notes`, if given, are printed after the bar of the matching row.
+std::string draw_histogram(const extract& h_data, const visualization_data& v_data,
+                           const std::vector<std::string>& row_notes = {}) {
   std::stringstream visualisation;
   
   visualisation << "\n" << get_external_line(v_data.external_line_shift_) << "\n";
 
   for (unsigned int i = 0; i < h_data.size(); i++)
-    visualisation << get_single_label(h_data, i, v_data.lower_bounds_width_, v_data.upper_bounds_width_) << "  "
-                  << get_single_str_value(v_data.str_values_, i, v_data.str_values_width_) << " "
-                  << get_single_histogram_line(v_data.scale_factors_, i) << "\n";
+    visualisation << get_histogram_row(h_data, v_data, i)
+                  << (i < row_notes.size() ? row_notes[i] : "") << "\n";
                    
   visualisation << get_external_line(v_data.external_line_shift_) << "\n\n";
   return visualisation.str();
 }
+
+inline void draw_latency_view(const extract& histogram_data, const quantile_index& index,
+                              const bar_scale scale, const std::vector<double>& quantiles) {
+  auto visualization_data = precalculate_visual_data(histogram_data, scale);
+
+  std::vector<std::string> notes(histogram_data.size());
+  for (const double q : quantiles) {
+    auto& note = notes[index.row(q)];
+    note += (note.empty() ? " <- " : " ") + str(boost::format("p%g") % (q * 100));
+  }
+
+  std::cout << "\n" << get_top_line(visualization_data.external_line_shift_,
+                                    histogram_data.values_, scale)
+            << draw_histogram(histogram_data, visualization_data, notes);
+}
+
 } // namespace
 
+// Defined here to count bins through bar_value, like extract_data().
+template <class histogram>
+void quantile_index::build(const histogram& h) {
+  clear();
+  for (auto&& x : boost::histogram::indexed(h, boost::histogram::coverage::all))
+    add(x.bin().lower(), x.bin().upper(), bar_value<typename histogram::value_type>(*x));
+  finish();
+}
+
+enum class export_format { csv, json, binary };
+
+// Layout of the binary export: this header, then bins + 1 bin edges and
+// bins counts, all doubles in native byte order. The header is 24 bytes,
+// so both arrays are 8-byte aligned.
+struct binary_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint64_t bins;
+};
+
+// Read-only view of a binary export in memory, e.g. a memory-mapped file.
+// Nothing is copied; the memory must outlive the view and start at an
+// address aligned for double, as the arrays are read in place. A mapped
+// file is, a blob at an arbitrary offset of a larger buffer may not be.
+class binary_view {
+public:
+  binary_view(const void* data, const size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(double) != 0)
+      throw std::invalid_argument("binary export is not aligned for double");
+    if (size < sizeof(binary_header))
+      throw std::invalid_argument("binary export is truncated");
+    std::memcpy(&header_, bytes, sizeof(binary_header));
+    if (std::memcmp(header_.magic, binary_magic, sizeof(binary_magic)) != 0 ||
+        header_.version != binary_version || header_.byte_order != binary_byte_order)
+      throw std::invalid_argument("not a binary histogram export");
+    // bins + 1 edges and bins counts; compared by division, since
+    // 2 * bins + 1 can overflow for a corrupt bin count.
+    const size_t doubles = (size - sizeof(binary_header)) / sizeof(double);
+    if (doubles == 0 || header_.bins > (doubles - 1) / 2)
+      throw std::invalid_argument("binary export is truncated");
+    edges_ = reinterpret_cast<const double*>(bytes + sizeof(binary_header));
+    counts_ = edges_ + header_.bins + 1;
+  }
+
+  size_t size() const { return header_.bins; }
+  const double* edges() const { return edges_; }   // size() + 1 values
+  const double* counts() const { return counts_; } // size() values
+
+private:
+  binary_header header_;
+  const double* edges_;
+  const double* counts_;
+};
+
+// Widths of the label and value columns of a frame.
+struct column_widths {
+  size_t lower_bounds = 0;
+  size_t upper_bounds = 0;
+  size_t values = 0;
+};
+
+// Renders the same picture as display(), but formats numbers with
+// std::to_chars straight into a buffer that is kept between calls,
+// so repeated renders of similarly sized histograms do not allocate.
+class renderer {
+public:
+  template <class histogram>
+  const std::string& render(const histogram& h) {
+    load(h);
+    return lay_out(widths());
+  }
+
+  template <class histogram>
+  std::ostream& render(const histogram& h, std::ostream& os) {
+    const auto& out = render(h);
+    return os.write(out.data(), out.size());
+  }
+
+  template <class histogram, class OutputIt>
+  OutputIt render_to(const histogram& h, OutputIt out) {
+    const auto& frame = render(h);
+    return std::copy(frame.begin(), frame.end(), out);
+  }
+
+  const std::string& buffer() const { return buffer_; }
+
+  // Single traversal of indexed(h, coverage::all); the result is used
+  // by both render() and write(). Only numbers are collected here, the
+  // value column is formatted by the first widths() or lay_out().
+  template <class histogram>
+  void load(const histogram& h) {
+    using value_type = typename histogram::value_type;
+    clear();
+    signed_integers_ = std::is_signed<value_type>::value;
+    for (auto&& x : indexed(h, coverage::all)) {
+      const value_type value = *x;
+      add(x.bin().lower(), x.bin().upper(), bar_value(value));
+      if constexpr (is_weighted_sum<value_type>::value)
+        variances_.push_back(value.variance());
+      else if constexpr (std::is_integral<value_type>::value)
+        integers_.push_back(static_cast<std::uint64_t>(value));
+    }
+  }
+
+  void load(const binary_view& view) {
+    clear();
+    for (size_t i = 0; i < view.size(); ++i)
+      add(view.edges()[i], view.edges()[i + 1], view.counts()[i]);
+  }
+
+  // Writes the bins of the last load() or render() in machine-readable
+  // form, without another pass over the histogram.
+  void write(std::ostream& os, const export_format format) {
+    if (format == export_format::binary) {
+      const binary_header header = make_header();
+      os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      os.write(reinterpret_cast<const char*>(lower_bounds_.data()),
+               lower_bounds_.size() * sizeof(double));
+      if (!upper_bounds_.empty())
+        os.write(reinterpret_cast<const char*>(&upper_bounds_.back()), sizeof(double));
+      os.write(reinterpret_cast<const char*>(values_.data()), values_.size() * sizeof(double));
+      return;
+    }
+
+    const bool json = format == export_format::json;
+    export_buffer_.clear();
+    export_buffer_ += json ? "{\"edges\": [" : "lower,upper,value\n";
+    if (json) {
+      for (size_t i = 0; i < lower_bounds_.size(); ++i) {
+        append_json_number(lower_bounds_[i]);
+        export_buffer_ += ", ";
+        flush_export(os, false);
+      }
+      if (!upper_bounds_.empty()) append_json_number(upper_bounds_.back());
+      export_buffer_ += "], \"counts\": [";
+    }
+    for (size_t i = 0; i < values_.size(); ++i) {
+      if (json) {
+        if (i) export_buffer_ += ", ";
+        append_json_number(values_[i]);
+      } else {
+        append_csv_number(lower_bounds_[i]);
+        export_buffer_ += ',';
+        append_csv_number(upper_bounds_[i]);
+        export_buffer_ += ',';
+        append_csv_number(values_[i]);
+        export_buffer_ += '\n';
+      }
+      flush_export(os, false);
+    }
+    if (json) export_buffer_ += "]}\n";
+    flush_export(os, true);
+  }
+
+  // Size of the binary export, and the export itself written to memory
+  // of at least that size, e.g. a memory-mapped file.
+  size_t binary_size() const {
+    return sizeof(binary_header) + (2 * values_.size() + 1) * sizeof(double);
+  }
+
+  void write_binary(void* destination) const {
+    const binary_header header = make_header();
+    // copied bytewise, so `destination` needs no particular alignment
+    const double last_edge = upper_bounds_.empty() ? 0 : upper_bounds_.back();
+    char* out = static_cast<char*>(destination);
+    auto put = [&out](const void* data, const size_t bytes) {
+      if (bytes) std::memcpy(out, data, bytes); // data is null for no bins
+      out += bytes;
+    };
+    put(&header, sizeof(header));
+    put(lower_bounds_.data(), lower_bounds_.size() * sizeof(double));
+    put(&last_edge, sizeof(double));
+    put(values_.data(), values_.size() * sizeof(double));
+  }
+
+private:
+  std::vector<double> lower_bounds_;
+  std::vector<double> upper_bounds_;
+  std::vector<double> values_;
+  std::vector<double> variances_;       // weighted storage only, else empty
+  std::vector<std::uint64_t> integers_; // exact integral contents, else empty
+  bool signed_integers_ = false;        // integers_ holds two's complement
+  std::string value_text_;              // formatted values, back to back
+  std::vector<size_t> value_ends_;      // end of each value in value_text_
+  bool formatted_ = false;              // value_text_ is up to date
+  std::string buffer_;
+  std::string export_buffer_;
+  char number_[max_number_width];
+
+  void clear() {
+    lower_bounds_.clear();
+    upper_bounds_.clear();
+    values_.clear();
+    variances_.clear();
+    integers_.clear();
+    value_text_.clear();
+    value_ends_.clear();
+    formatted_ = false;
+  }
+
+  void add(const double lower, const double upper, const double value) {
+    lower_bounds_.push_back(lower);
+    upper_bounds_.push_back(upper);
+    values_.push_back(value);
+  }
+
+  binary_header make_header() const {
+    binary_header header;
+    std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+    header.version = binary_version;
+    header.byte_order = binary_byte_order;
+    header.bins = values_.size();
+    return header;
+  }
+
+  // Shortest representation that reads back to the same double.
+  void append_csv_number(const double number) {
+    export_buffer_.append(number_, std::to_chars(number_, number_ + max_number_width, number).ptr);
+  }
+
+  // JSON has no infinities; unbounded edges are written as null.
+  void append_json_number(const double number) {
+    if (std::isfinite(number))
+      append_csv_number(number);
+    else
+      export_buffer_ += "null";
+  }
+
+  void flush_export(std::ostream& os, const bool force) {
+    if (!force && export_buffer_.size() < export_chunk_size) return;
+    os.write(export_buffer_.data(), export_buffer_.size());
+    export_buffer_.clear();
+  }
+
+  void append(const char c, const size_t count) { buffer_.append(count, c); }
+
+  void append_text(const char* text, const size_t length, const size_t width, const bool left) {
+    const size_t padding = length < width ? width - length : 0;
+    if (!left) append(' ', padding);
+    buffer_.append(text, length);
+    if (left) append(' ', padding);
+  }
+
+  void append_number(const size_t length, const size_t width, const bool left) {
+    append_text(number_, length, width, left);
+  }
+
+  size_t value_begin(const size_t index) const { return index ? value_ends_[index - 1] : 0; }
+
+  // Same text as format_value() on the bin content that was loaded.
+  size_t format_bin(const size_t i) {
+    char* const last = number_ + max_number_width;
+    if (!variances_.empty()) return format_weighted(number_, values_[i], variances_[i]);
+    if (integers_.empty()) return format_number(number_, values_[i]);
+    if (signed_integers_)
+      return std::to_chars(number_, last, static_cast<std::int64_t>(integers_[i])).ptr - number_;
+    return std::to_chars(number_, last, integers_[i]).ptr - number_;
+  }
+
+  void format_values() {
+    if (formatted_) return;
+    for (size_t i = 0; i < values_.size(); ++i) {
+      value_text_.append(number_, format_bin(i));
+      value_ends_.push_back(value_text_.size());
+    }
+    formatted_ = true;
+  }
+
+  void append_external_line(const size_t shift) {
+    append(' ', shift);
+    buffer_ += " +";
+    append('-', histogram_width);
+    buffer_ += "+\n";
+  }
+
+public:
+  // Column widths the loaded bins need.
+  column_widths widths() {
+    format_values();
+    column_widths w;
+    for (size_t i = 0; i < values_.size(); ++i) {
+      w.lower_bounds = std::max(w.lower_bounds, format_bound(number_, lower_bounds_[i]));
+      w.upper_bounds = std::max(w.upper_bounds, format_bound(number_, upper_bounds_[i]));
+      w.values = std::max(w.values, value_ends_[i] - value_begin(i));
+    }
+    return w;
+  }
+
+  // Lays out the loaded bins with the given column widths, which may be
+  // wider than widths() to line up several frames.
+  const std::string& lay_out(const column_widths& widths) {
+    const unsigned int additional_offset = 6; // 6 white characters
+    const unsigned int longest_bin = max_bin_coefficient * histogram_width;
+    format_values();
+    const size_t lower_width = widths.lower_bounds;
+    const size_t upper_width = widths.upper_bounds;
+    const size_t values_width = widths.values;
+    double max_value = 0;
+    for (const double value : values_) max_value = std::max(max_value, value);
+    const size_t shift = lower_width + upper_width + values_width + additional_offset;
+
+    buffer_.clear();
+    buffer_ += '\n';
+    append_external_line(shift);
+    for (size_t i = 0; i < values_.size(); ++i) {
+      buffer_ += '[';
+      append_number(format_bound(number_, lower_bounds_[i]), lower_width, false);
+      buffer_ += ", ";
+      append_number(format_bound(number_, upper_bounds_[i]), upper_width, false);
+      buffer_ += i == values_.size() - 1 ? "]  " : ")  ";
+      append_text(value_text_.data() + value_begin(i), value_ends_[i] - value_begin(i),
+                  values_width, true);
+      buffer_ += " |";
+
+      const unsigned int bar =
+          max_value > 0 ? std::max(0.0, values_[i] * longest_bin / max_value) : 0;
+      append('*', bar);
+      append(' ', histogram_width - bar);
+      buffer_ += "|\n";
+    }
+    append_external_line(shift);
+    buffer_ += '\n';
+    return buffer_;
+  }
+};
+
 template <class histogram>
 void display(const histogram& h) {
 
@@ -206,6 +738,691 @@ void display(const histogram& h) {
   std::cout << draw_histogram(histogram_data, visualization_data);
 }
 
+template <class histogram>
+void display(const histogram& h, std::ostream& os) {
+  renderer r;
+  r.render(h, os);
+}
+
+// Re-renders a binary export straight from memory.
+inline void display(const binary_view& view, std::ostream& os = std::cout) {
+  renderer r;
+  r.render(view, os);
+}
+
+// Streams the bin edges and contents of h as CSV, JSON or binary.
+template <class histogram>
+void export_data(const histogram& h, std::ostream& os, const export_format format) {
+  renderer r;
+  r.load(h);
+  r.write(os, format);
+}
+
+// Keeps a histogram on screen and redraws it in place. After the first
+// frame only rows whose bar or count changed are rewritten, using ANSI
+// cursor movement; the whole frame is redrawn when the maximum value,
+// a column width or the binning changes.
+class live_view {
+public:
+  explicit live_view(std::ostream& os = std::cout,
+                     std::chrono::milliseconds min_interval = std::chrono::milliseconds(100))
+      : os_{os}, min_interval_{min_interval} {}
+
+  // Returns false if the refresh was skipped because of the rate limit.
+  template <class histogram>
+  bool refresh(const histogram& h) {
+    const auto now = std::chrono::steady_clock::now();
+    if (v_data_ && now - last_refresh_ < min_interval_)
+      return false;
+    last_refresh_ = now;
+
+    auto h_data = extract_data(h);
+    auto v_data = precalculate_visual_data(h_data);
+    const double max_value = *std::max_element(h_data.values_.begin(), h_data.values_.end());
+
+    if (needs_full_redraw(h_data, v_data, max_value))
+      redraw(h_data, v_data);
+    else
+      update_rows(h_data, v_data);
+
+    os_.flush();
+    h_data_ = std::move(h_data);
+    v_data_ = std::move(v_data);
+    max_value_ = max_value;
+    return true;
+  }
+
+  // Forces the next refresh to print a new frame below the current one.
+  void invalidate() {
+    h_data_.reset();
+    v_data_.reset();
+  }
+
+private:
+  std::ostream& os_;
+  std::chrono::milliseconds min_interval_;
+  std::chrono::steady_clock::time_point last_refresh_;
+  std::optional<extract> h_data_;
+  std::optional<visualization_data> v_data_;
+  double max_value_ = 0;
+
+  // draw_histogram() prints a blank line and a border above the rows,
+  // and a border and a blank line below them.
+  static unsigned int frame_height(const extract& h_data) { return h_data.size() + 4; }
+
+  bool needs_full_redraw(const extract& h_data, const visualization_data& v_data,
+                         const double max_value) const {
+    return !v_data_ ||
+           max_value != max_value_ ||
+           h_data.lower_bounds_ != h_data_->lower_bounds_ ||
+           h_data.upper_bounds_ != h_data_->upper_bounds_ ||
+           v_data.str_values_width_ != v_data_->str_values_width_;
+  }
+
+  void redraw(const extract& h_data, const visualization_data& v_data) {
+    if (v_data_)
+      os_ << "\033[" << frame_height(*h_data_) << "A\r\033[J";
+    os_ << draw_histogram(h_data, v_data);
+  }
+
+  void update_rows(const extract& h_data, const visualization_data& v_data) {
+    for (unsigned int i = 0; i < h_data.size(); i++) {
+      if (v_data.scale_factors_[i] == v_data_->scale_factors_[i] &&
+          v_data.str_values_[i] == v_data_->str_values_[i])
+        continue;
+
+      const unsigned int distance = frame_height(h_data) - 2 - i;
+      os_ << "\033[" << distance << "A\r"
+          << get_histogram_row(h_data, v_data, i)
+          << "\033[" << distance << "B\r";
+    }
+  }
+};
+
+enum class reduction { sum, max, mean };
+
+// Multi-resolution copy of the inner bins of a 1D histogram. Level k holds
+// the sums and maxima of aligned groups of 2^k adjacent bins, so a view
+// with any number of rows is built from one level instead of the storage.
+// Underflow and overflow bins are kept aside and shown unreduced.
+class bin_pyramid {
+public:
+  template <class histogram>
+  explicit bin_pyramid(const histogram& h) { rebuild(h); }
+
+  // Rescans the storage; call it after the histogram has been filled.
+  template <class histogram>
+  void rebuild(const histogram& h) {
+    // The storage is walked as the bins of a single axis.
+    if (h.rank() != 1)
+      throw std::invalid_argument("bin_pyramid needs a one-dimensional histogram");
+    const auto& ax = h.axis(0);
+    const unsigned int options = axis::traits::options(ax);
+    const unsigned int size = ax.size();
+    has_underflow_ = options & axis::option::underflow_t::value;
+    has_overflow_ = options & axis::option::overflow_t::value;
+
+    edges_.resize(size + 1);
+    for (unsigned int i = 0; i < size; ++i)
+      edges_[i] = ax.bin(i).lower();
+    edges_[size] = ax.bin(size - 1).upper();
+    underflow_lower_ = ax.bin(-1).lower();
+    overflow_upper_ = ax.bin(size).upper();
+
+    sums_.resize(1);
+    maxima_.resize(1);
+    auto& counts = sums_[0];
+    counts.resize(size);
+    auto it = h.begin();
+    using value_type = typename histogram::value_type;
+    if (has_underflow_) underflow_value_ = bar_value<value_type>(*it++);
+    for (unsigned int i = 0; i < size; ++i, ++it)
+      counts[i] = bar_value<value_type>(*it);
+    if (has_overflow_) overflow_value_ = bar_value<value_type>(*it);
+    maxima_[0] = counts;
+
+    while (sums_.back().size() > 1) {
+      sums_.push_back(reduce_level(sums_.back(), [](double a, double b) { return a + b; }));
+      maxima_.push_back(reduce_level(maxima_.back(), [](double a, double b) { return std::max(a, b); }));
+    }
+  }
+
+  // Number of inner bins.
+  unsigned int size() const { return sums_[0].size(); }
+
+  extract view(const unsigned int rows, const reduction r = reduction::sum) const {
+    return view(0, size(), rows, r);
+  }
+
+  // Shows inner bins [first, last) in at most `rows` rows, counting the
+  // flow bins that fall into the view; they are left out first when there
+  // are not enough rows. Each row combines whole groups of one pyramid
+  // level, so the range is widened to the boundaries of those groups and
+  // row widths differ by at most one group (about 1/64 of a row).
+  extract view(const unsigned int first, const unsigned int last,
+               const unsigned int rows, const reduction r) const {
+    const unsigned int end_bin = std::min(last, size());
+    const unsigned int span = end_bin > first ? end_bin - first : 0;
+    const unsigned int total_rows = std::max(rows, 1u);
+    bool underflow = has_underflow_ && first == 0;
+    bool overflow = has_overflow_ && end_bin == size();
+    const unsigned int inner_rows = std::min(
+        span, std::max(1u, total_rows - std::min(total_rows - 1, 0u + underflow + overflow)));
+    if (inner_rows + underflow + overflow > total_rows) overflow = false;
+    if (inner_rows + underflow + overflow > total_rows) underflow = false;
+
+    // finest level that still leaves about groups_per_row groups per row
+    const unsigned int groups_per_row = 64;
+    unsigned int level = 0, group = 1;
+    while (level + 1 < sums_.size() &&
+           static_cast<std::uint64_t>(group) * 2 * inner_rows * groups_per_row <= span) {
+      ++level;
+      group *= 2;
+    }
+    const unsigned int first_group = first / group;
+    const unsigned int groups = span ? (end_bin + group - 1) / group - first_group : 0;
+
+    extract ex;
+    if (underflow) add_row(ex, underflow_lower_, edges_[0], underflow_value_);
+    for (unsigned int row = 0; row < inner_rows; ++row) {
+      const unsigned int a = first_group + static_cast<std::uint64_t>(row) * groups / inner_rows;
+      const unsigned int b = first_group + static_cast<std::uint64_t>(row + 1) * groups / inner_rows;
+      double sum = 0, max = 0;
+      for (unsigned int j = a; j < b; ++j) {
+        sum += sums_[level][j];
+        max = j == a ? maxima_[level][j] : std::max(max, maxima_[level][j]);
+      }
+      const unsigned int lower_bin = a * group;
+      const unsigned int upper_bin = std::min(b * group, size());
+      double value = sum;
+      if (r == reduction::max)
+        value = max;
+      else if (r == reduction::mean)
+        value = sum / (upper_bin - lower_bin);
+      add_row(ex, edges_[lower_bin], edges_[upper_bin], value);
+    }
+    if (overflow) add_row(ex, edges_[size()], overflow_upper_, overflow_value_);
+    return ex;
+  }
+
+private:
+  std::vector<double> edges_;
+  std::vector<std::vector<double>> sums_;
+  std::vector<std::vector<double>> maxima_;
+  bool has_underflow_ = false;
+  bool has_overflow_ = false;
+  double underflow_lower_ = 0, overflow_upper_ = 0;
+  double underflow_value_ = 0, overflow_value_ = 0;
+
+  // Pairwise combination of neighbours; a plain indexed loop so that the
+  // compiler can vectorize it.
+  template <class op>
+  static std::vector<double> reduce_level(const std::vector<double>& in, op combine) {
+    const size_t pairs = in.size() / 2;
+    std::vector<double> out((in.size() + 1) / 2);
+    for (size_t j = 0; j < pairs; ++j)
+      out[j] = combine(in[2 * j], in[2 * j + 1]);
+    if (out.size() != pairs) out[pairs] = in.back();
+    return out;
+  }
+
+  static void add_row(extract& ex, const double lower, const double upper, const double value) {
+    char number[max_number_width];
+    ex.lower_bounds_.emplace_back(number, format_bound(number, lower));
+    ex.upper_bounds_.emplace_back(number, format_bound(number, upper));
+    ex.values_.push_back(value);
+    ex.str_values_.push_back(value_to_string(value));
+  }
+};
+
+// Shows the histogram in at most `rows` rows by combining adjacent bins.
+template <class histogram>
+void display(const histogram& h, const unsigned int rows,
+             const reduction r = reduction::sum) {
+  auto histogram_data = bin_pyramid(h).view(rows, r);
+  auto visualization_data = precalculate_visual_data(histogram_data);
+
+  std::cout << draw_histogram(histogram_data, visualization_data);
+}
+
+// Allocates whole, aligned cache lines, so that no other allocation can
+// share a line with the first or last elements of the buffer.
+template <class T>
+struct cache_line_allocator {
+  using value_type = T;
+
+  cache_line_allocator() = default;
+  template <class U>
+  cache_line_allocator(const cache_line_allocator<U>&) noexcept {}
+
+  T* allocate(const size_t n) {
+    return static_cast<T*>(::operator new(padded_size(n), std::align_val_t(cache_line_size)));
+  }
+
+  void deallocate(T* p, const size_t n) noexcept {
+    ::operator delete(p, padded_size(n), std::align_val_t(cache_line_size));
+  }
+
+  static size_t padded_size(const size_t n) {
+    return (n * sizeof(T) + cache_line_size - 1) / cache_line_size * cache_line_size;
+  }
+
+  template <class U>
+  bool operator==(const cache_line_allocator<U>&) const noexcept { return true; }
+  template <class U>
+  bool operator!=(const cache_line_allocator<U>&) const noexcept { return false; }
+};
+
+// Histogram that many threads fill at once. Every thread adds to one of
+// several shards holding atomic counters. Both the shard objects and
+// their counter buffers occupy cache lines of their own, so fillers
+// neither contend nor block while snapshot() merges the shards into a
+// plain histogram for display.
+template <class histogram>
+class sharded_histogram {
+public:
+  using counter_type = accumulators::thread_safe<std::uint64_t>;
+  using shard_type = boost::histogram::histogram<
+      typename histogram::axes_type,
+      storage_adaptor<std::vector<counter_type, cache_line_allocator<counter_type>>>>;
+
+  // `prototype` provides the axes; its contents are ignored.
+  explicit sharded_histogram(const histogram& prototype,
+                             unsigned int shards = std::thread::hardware_concurrency())
+      : prototype_{prototype}, shards_(std::max(shards, 1u), padded_shard{shard_type(prototype)}) {
+    prototype_.reset();
+    for (auto& s : shards_) s.h.reset();
+  }
+
+  template <class... Ts>
+  void operator()(const Ts&... xs) {
+    fill(thread_slot(), xs...);
+  }
+
+  // Fills an explicitly chosen shard, e.g. the index of a worker thread.
+  template <class... Ts>
+  void fill(const unsigned int shard, const Ts&... xs) {
+    shards_[shard % shards_.size()].h(xs...);
+  }
+
+  histogram snapshot() const {
+    histogram merged = prototype_;
+    for (const auto& s : shards_) {
+      auto out = merged.begin();
+      for (const auto& count : s.h) *out++ += count.load(std::memory_order_relaxed);
+    }
+    return merged;
+  }
+
+  unsigned int shards() const { return shards_.size(); }
+
+private:
+  struct alignas(cache_line_size) padded_shard {
+    shard_type h;
+  };
+
+  histogram prototype_;
+  std::vector<padded_shard> shards_;
+
+  static unsigned int thread_slot() {
+    static std::atomic<unsigned int> next_slot{0};
+    thread_local const unsigned int slot = next_slot++;
+    return slot;
+  }
+};
+
+template <class histogram>
+void display(const sharded_histogram<histogram>& h) {
+  display(h.snapshot());
+}
+
+enum class layout { stacked, grid };
+
+struct batch_options {
+  layout arrangement = layout::stacked;
+  unsigned int grid_columns = 2;
+  unsigned int threads = std::thread::hardware_concurrency(); // for draw_histograms()
+};
+
+// Fixed set of worker threads that run index ranges for the calling
+// thread, which takes part as well. The threads live as long as the pool.
+class thread_pool {
+public:
+  explicit thread_pool(const unsigned int threads) : size_{std::max(threads, 1u)} {
+    for (unsigned int w = 1; w < size_; ++w)
+      workers_.emplace_back([this, w] { work(w); });
+  }
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& t : workers_) t.join();
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  unsigned int size() const { return size_; }
+
+  // Calls f(i) for i in [0, n), split into one contiguous chunk per
+  // thread, and returns when all calls have finished.
+  template <class function>
+  void run(const size_t n, function& f) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &f;
+      call_ = [](void* task, const size_t i) { (*static_cast<function*>(task))(i); };
+      n_ = n;
+      pending_ = workers_.size();
+      ++generation_;
+    }
+    start_.notify_all();
+    run_chunk(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+  }
+
+private:
+  const unsigned int size_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  bool stop_ = false;
+  std::uint64_t generation_ = 0;
+  size_t pending_ = 0;
+  size_t n_ = 0;
+  void* task_ = nullptr;
+  void (*call_)(void*, size_t) = nullptr;
+
+  void work(const unsigned int w) {
+    std::uint64_t seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) return;
+        seen = generation_;
+      }
+      run_chunk(w);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--pending_ == 0) done_.notify_one();
+    }
+  }
+
+  void run_chunk(const unsigned int w) {
+    const size_t chunk = (n_ + size_ - 1) / size_;
+    for (size_t i = w * chunk; i < std::min(n_, (w + 1) * chunk); ++i) call_(task_, i);
+  }
+};
+
+// Draws a range of histograms as one frame. Every histogram has its own
+// streaming renderer, kept between calls; loading and layout run on a
+// thread pool, and all histograms share the column widths so that they
+// line up. `titles`, if given, are printed above the matching frame.
+// Keep one batch_renderer for repeated dumps to reuse threads and buffers.
+class batch_renderer {
+public:
+  explicit batch_renderer(const unsigned int threads = std::thread::hardware_concurrency())
+      : pool_(threads) {}
+
+  template <class histograms>
+  const std::string& render(const histograms& hs,
+                            const std::vector<std::string>& titles = {},
+                            const batch_options& options = {}) {
+    size_t n = 0;
+    for (auto it = std::begin(hs); it != std::end(hs); ++it) ++n;
+    if (renderers_.size() < n) renderers_.resize(n);
+    widths_.resize(n);
+    line_ends_.resize(n);
+
+    std::vector<const typename histograms::value_type*> items;
+    items.reserve(n);
+    for (const auto& h : hs) items.push_back(&h);
+
+    auto load = [&](const size_t i) {
+      renderers_[i].load(*items[i]);
+      widths_[i] = renderers_[i].widths();
+    };
+    pool_.run(n, load);
+
+    column_widths shared;
+    for (size_t i = 0; i < n; ++i) {
+      shared.lower_bounds = std::max(shared.lower_bounds, widths_[i].lower_bounds);
+      shared.upper_bounds = std::max(shared.upper_bounds, widths_[i].upper_bounds);
+      shared.values = std::max(shared.values, widths_[i].values);
+    }
+
+    const bool grid = options.arrangement == layout::grid;
+    auto draw = [&](const size_t i) {
+      const std::string& frame = renderers_[i].lay_out(shared);
+      line_ends_[i].clear();
+      if (grid)
+        for (size_t p = frame.find('\n'); p != std::string::npos; p = frame.find('\n', p + 1))
+          line_ends_[i].push_back(p);
+    };
+    pool_.run(n, draw);
+
+    frame_.clear();
+    if (grid)
+      arrange_grid(n, titles, std::max(options.grid_columns, 1u));
+    else
+      arrange_stacked(n, titles);
+    return frame_;
+  }
+
+private:
+  thread_pool pool_;
+  std::vector<renderer> renderers_;
+  std::vector<column_widths> widths_;
+  std::vector<std::vector<size_t>> line_ends_; // of each frame, for the grid
+  std::string frame_;
+
+  static const std::string& title(const std::vector<std::string>& titles, const size_t i) {
+    static const std::string none;
+    return i < titles.size() ? titles[i] : none;
+  }
+
+  void arrange_stacked(const size_t n, const std::vector<std::string>& titles) {
+    size_t size = 0;
+    for (size_t i = 0; i < n; ++i) size += title(titles, i).size() + renderers_[i].buffer().size();
+    frame_.reserve(size);
+    for (size_t i = 0; i < n; ++i) {
+      frame_ += title(titles, i);
+      frame_ += renderers_[i].buffer();
+    }
+  }
+
+  // Line `row` of cell i: the title, then the frame after its leading
+  // blank line.
+  std::pair<const char*, size_t> cell_line(const std::vector<std::string>& titles,
+                                           const size_t i, const size_t row) const {
+    if (row == 0) return {title(titles, i).data(), title(titles, i).size()};
+    const auto& ends = line_ends_[i];
+    if (row >= ends.size()) return {nullptr, 0};
+    const size_t begin = ends[row - 1] + 1;
+    return {renderers_[i].buffer().data() + begin, ends[row] - begin};
+  }
+
+  // Places the frames next to each other, `columns` per row of the grid.
+  void arrange_grid(const size_t n, const std::vector<std::string>& titles,
+                    const unsigned int columns) {
+    size_t cell_width = 0, height = 0;
+    for (size_t i = 0; i < n; ++i) {
+      height = std::max(height, line_ends_[i].size());
+      for (size_t row = 0; row < line_ends_[i].size(); ++row)
+        cell_width = std::max(cell_width, cell_line(titles, i, row).second);
+    }
+    frame_.reserve((n + columns - 1) / columns * height * (columns * (cell_width + 2) + 1));
+
+    for (size_t first = 0; first < n; first += columns) {
+      const size_t last = std::min(n, first + columns);
+      size_t rows = 0;
+      for (size_t i = first; i < last; ++i) rows = std::max(rows, line_ends_[i].size());
+
+      for (size_t row = 0; row < rows; ++row) {
+        size_t padding = 0; // written only if more text follows on the line
+        for (size_t i = first; i < last; ++i) {
+          const auto line = cell_line(titles, i, row);
+          if (line.second) {
+            frame_.append(padding, ' ');
+            frame_.append(line.first, line.second);
+            padding = 0;
+          }
+          padding += cell_width - line.second + 2;
+        }
+        frame_ += '\n';
+      }
+    }
+  }
+};
+
+// One-off batch; builds a batch_renderer with options.threads threads.
+template <class histograms>
+std::string draw_histograms(const histograms& hs,
+                            const std::vector<std::string>& titles = {},
+                            const batch_options& options = {}) {
+  batch_renderer batch(options.threads);
+  return batch.render(hs, titles, options);
+}
+
+template <class histograms>
+void display_all(const histograms& hs,
+                 const std::vector<std::string>& titles = {},
+                 const batch_options& options = {},
+                 std::ostream& os = std::cout) {
+  batch_renderer batch(options.threads);
+  const auto& frame = batch.render(hs, titles, options);
+  os.write(frame.data(), frame.size());
+  os.flush();
+}
+
+// Latency view: bars on a log scale, so that a tall peak does not flatten
+// the tail, with markers on the rows holding the requested quantiles.
+// `index` is reused as is, so quantiles are not recomputed from the
+// storage; refresh it with index.build(h) after filling. Throws
+// std::invalid_argument if it no longer matches the histogram.
+template <class histogram>
+void display(const histogram& h, const quantile_index& index,
+             const bar_scale scale = bar_scale::log,
+             const std::vector<double>& quantiles = {0.5, 0.99, 0.999}) {
+  const auto histogram_data = extract_data(h);
+  if (!index.matches(histogram_data))
+    throw std::invalid_argument("quantile_index is stale, rebuild it from the histogram");
+  draw_latency_view(histogram_data, index, scale, quantiles);
+}
+
+enum class heatmap_palette { ascii, ansi256 };
+
+struct heatmap_options {
+  unsigned int width = 80;  // columns for the cells
+  unsigned int height = 24; // rows for the cells
+  heatmap_palette palette = heatmap_palette::ascii;
+  bar_scale scale = bar_scale::linear;
+};
+
+// Draws a 2D histogram as a grid of cells shaded by count, the first axis
+// horizontal and the second vertical (increasing upwards). Neighbouring
+// bins are summed so that the grid fits into width x height; flow bins are
+// left out.
+template <class histogram>
+std::string draw_heatmap(const histogram& h, const heatmap_options& options = {}) {
+  // The storage is walked as x_extent * y_extent cells.
+  if (h.rank() != 2)
+    throw std::invalid_argument("draw_heatmap needs a two-dimensional histogram");
+  const auto& x_axis = h.axis(0);
+  const auto& y_axis = h.axis(1);
+  const unsigned int nx = x_axis.size(), ny = y_axis.size();
+  const unsigned int x_extent = axis::traits::extent(x_axis);
+  const unsigned int y_extent = axis::traits::extent(y_axis);
+  const unsigned int x_shift = (axis::traits::options(x_axis) & axis::option::underflow_t::value) ? 1 : 0;
+  const unsigned int y_shift = (axis::traits::options(y_axis) & axis::option::underflow_t::value) ? 1 : 0;
+  const unsigned int columns = std::max(1u, std::min(options.width, nx));
+  const unsigned int rows = std::max(1u, std::min(options.height, ny));
+
+  // target column of every position along the first axis; flow bins map
+  // to `columns` and are skipped
+  std::vector<unsigned int> column_of(x_extent, columns);
+  for (unsigned int i = 0; i < nx; ++i)
+    column_of[i + x_shift] = static_cast<std::uint64_t>(i) * columns / nx;
+
+  // The storage keeps the first axis contiguous, so it is read strictly in
+  // order: each block of x_extent values is one bin of the second axis and
+  // is folded into a single row of cells, which stays in cache.
+  std::vector<double> cells(static_cast<size_t>(columns) * rows, 0.0);
+  auto it = h.begin();
+  for (unsigned int j = 0; j < y_extent; ++j) {
+    const unsigned int y = j - y_shift;
+    if (j < y_shift || y >= ny) {
+      std::advance(it, x_extent);
+      continue;
+    }
+    double* row = &cells[static_cast<std::uint64_t>(y) * rows / ny * columns];
+    for (unsigned int i = 0; i < x_extent; ++i, ++it)
+      if (column_of[i] < columns)
+        row[column_of[i]] += bar_value<typename histogram::value_type>(*it);
+  }
+
+  const double max_value = *std::max_element(cells.begin(), cells.end());
+  const double top = options.scale == bar_scale::log ? std::log1p(max_value) : max_value;
+
+  const std::string ramp = " .:-=+*#%@";
+  const std::vector<int> colors = {17, 18, 19, 20, 21, 27, 33, 39, 45, 51, 50, 49, 48,
+                                   47, 46, 82, 118, 154, 190, 226, 220, 214, 208, 202, 196};
+  const size_t levels = options.palette == heatmap_palette::ascii ? ramp.size() - 1 : colors.size();
+  auto level_of = [&](const double value) -> size_t { // 0 is an empty cell
+    if (value <= 0 || top <= 0) return 0;
+    const double v = options.scale == bar_scale::log ? std::log1p(value) : value;
+    return std::min<size_t>(levels, std::max(1.0, std::ceil(v / top * levels)));
+  };
+
+  char number[max_number_width];
+  std::vector<std::string> labels(rows);
+  size_t label_width = 0;
+  for (unsigned int r = 0; r < rows; ++r) {
+    const unsigned int first_bin = (static_cast<std::uint64_t>(r) * ny + rows - 1) / rows;
+    labels[r].assign(number, format_bound(number, y_axis.bin(first_bin).lower()));
+    label_width = std::max(label_width, labels[r].size());
+  }
+
+  std::string frame = "\n";
+  const std::string border = std::string(label_width, ' ') + " +" + std::string(columns, '-') + "+\n";
+  frame += border;
+  for (unsigned int r = rows; r-- > 0;) {
+    frame += std::string(label_width - labels[r].size(), ' ') + labels[r] + " |";
+    int current_color = -1;
+    for (unsigned int c = 0; c < columns; ++c) {
+      const size_t level = level_of(cells[static_cast<size_t>(r) * columns + c]);
+      if (options.palette == heatmap_palette::ascii) {
+        frame += ramp[level];
+        continue;
+      }
+      const int color = level ? colors[level - 1] : -1;
+      if (color != current_color)
+        frame += color < 0 ? std::string("\033[0m") : "\033[48;5;" + std::to_string(color) + "m";
+      current_color = color;
+      frame += ' ';
+    }
+    if (current_color >= 0) frame += "\033[0m";
+    frame += "|\n";
+  }
+  frame += border;
+
+  const std::string lower(number, format_bound(number, x_axis.bin(0).lower()));
+  const std::string upper(number, format_bound(number, x_axis.bin(nx - 1).upper()));
+  const size_t gap = columns + 2 > lower.size() + upper.size() ? columns + 2 - lower.size() - upper.size() : 1;
+  frame += std::string(label_width + 1, ' ') + lower + std::string(gap, ' ') + upper + "\n\n";
+  return frame;
+}
+
+template <class histogram>
+void display_heatmap(const histogram& h, const heatmap_options& options = {}) {
+  std::cout << draw_heatmap(h, options);
+}
+
 } // namespace display
 
-#endif
\ No newline at end of file
+#endif
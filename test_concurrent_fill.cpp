@@ -0,0 +1,77 @@
+#include "display.hpp"
+
+#include <cstdlib>
+#include <random>
+
+int main() {
+  using namespace boost::histogram;
+
+  const unsigned int fills_per_thread = 2000000;
+  const unsigned int max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+
+  auto prototype = make_histogram(axis::regular<>(20, -3.0, 3.0));
+  using sharded = display::sharded_histogram<decltype(prototype)>;
+  double single_thread_rate = 0, last_rate = 0;
+  unsigned int last_threads = 1;
+
+  // fills h from `threads` workers, one shard each; returns the seconds taken
+  auto fill = [&](sharded& h, const unsigned int threads) {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t)
+      workers.emplace_back([&h, t] {
+        std::mt19937 gen(t);
+        std::normal_distribution<double> dist;
+        for (unsigned int i = 0; i < fills_per_thread; ++i) h.fill(t, dist(gen));
+      });
+    for (auto& w : workers) w.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  };
+
+  for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+    // throughput is timed on its own, so the monitor below does not take
+    // a core or pull the shards' cache lines away from the workers
+    sharded timed(prototype, threads);
+    const double expected = double(fills_per_thread) * threads;
+    last_rate = expected / fill(timed, threads);
+    last_threads = threads;
+    if (threads == 1) single_thread_rate = last_rate;
+
+    sharded h(prototype, threads);
+    std::atomic<bool> done{false};
+    unsigned int frames = 0;
+
+    // monitoring thread keeps taking snapshots while the workers fill
+    std::thread monitor([&] {
+      while (!done) {
+        auto frame = h.snapshot();
+        (void)frame;
+        ++frames;
+      }
+    });
+    fill(h, threads);
+    done = true;
+    monitor.join();
+
+    const auto merged = h.snapshot();
+    const double total = algorithm::sum(merged);
+    std::cout << threads << " threads: "
+              << last_rate / 1e6 << " Mfills/s, "
+              << frames << " snapshots taken during a second fill\n";
+    if (total != expected) {
+      std::cout << "lost fills: " << expected - total << "\n";
+      return EXIT_FAILURE;
+    }
+
+    if (threads * 2 > max_threads) display::display(h);
+  }
+
+  // Reported, not enforced: hardware_concurrency() counts SMT siblings
+  // and shared CI machines are noisy, so no speed-up can be required.
+  // Without false sharing it should approach the number of physical cores.
+  std::cout << "speed-up with " << last_threads << " threads: "
+            << last_rate / single_thread_rate << "x\n";
+
+  return EXIT_SUCCESS;
+}
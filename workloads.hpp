@@ -0,0 +1,80 @@
+#ifndef WORKLOADS_HPP
+#define WORKLOADS_HPP
+
+#include <boost/histogram.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace workloads {
+
+enum class distribution { uniform, normal, latency };
+
+inline std::string name(const distribution d) {
+  switch (d) {
+    case distribution::uniform: return "uniform";
+    case distribution::normal: return "normal";
+    default: return "latency";
+  }
+}
+
+// Seeded sample source. Only the raw mt19937_64 output is used, because
+// the std:: distributions differ between standard libraries and would
+// make golden output depend on the platform.
+class generator {
+public:
+  generator(const distribution d, const std::uint64_t seed) : d_{d}, engine_{seed} {}
+
+  double operator()() {
+    switch (d_) {
+      case distribution::uniform: return uniform();
+      case distribution::normal: return normal();
+      default: return std::exp(0.5 * normal()); // log-normal with a long tail
+    }
+  }
+
+private:
+  distribution d_;
+  std::mt19937_64 engine_;
+
+  double uniform() { return (engine_() >> 11) * 0x1.0p-53; }
+
+  double normal() { // Box-Muller, one value per call
+    const double pi = 3.14159265358979323846;
+    const double u1 = 1.0 - uniform();
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * pi * uniform());
+  }
+};
+
+// Histogram whose range covers the bulk of the given distribution.
+inline auto make_histogram(const distribution d, const unsigned int bins) {
+  using boost::histogram::axis::regular;
+  switch (d) {
+    case distribution::uniform: return boost::histogram::make_histogram(regular<>(bins, 0.0, 1.0));
+    case distribution::normal: return boost::histogram::make_histogram(regular<>(bins, -4.0, 4.0));
+    default: return boost::histogram::make_histogram(regular<>(bins, 0.0, 6.0));
+  }
+}
+
+template <class histogram>
+void fill(histogram& h, const distribution d, const std::uint64_t samples,
+          const std::uint64_t seed = 1) {
+  const std::uint64_t batch_size = 4096;
+  generator gen(d, seed);
+  std::vector<double> batch;
+  batch.reserve(batch_size);
+
+  for (std::uint64_t done = 0; done < samples;) {
+    batch.clear();
+    for (; batch.size() < batch_size && done < samples; ++done)
+      batch.push_back(gen());
+    h.fill(batch);
+  }
+}
+
+} // namespace workloads
+
+#endif